@@ -4,7 +4,7 @@
     AUTHOR:  xiaolong Zhang
     EMAIL:   xiaolongzhang2015@163.com
     DATE:    2020-06-26
-    UPDATE:  2020-08-16
+    UPDATE:  2026-10-17
 '''
 
 import pdb
@@ -12,57 +12,75 @@ import pdb
 import sys
 import os
 import os.path
+import itertools
 
 
-def get_locus(locus_file):
-    file_fp = open(locus_file, "r")
+def get_locus(locus_fp, locus_file):
+    h_list = locus_fp.readline().split()
 
-    h_list = file_fp.readline().split()
-
-    if h_list[0] != '#Locus':
+    if not h_list or h_list[0] != '#Locus':
         sys.stderr.write("[Error] %s is not generated by STRCaller!\n" % locus_file)
         sys.exit(-1)
 
     return h_list[1].rstrip()
 
 
-def read_locus(locus_file):
-    a_list = []
-    fp = open(locus_file, "r")
-
-    for line in fp:
+def read_locus(locus_fp):
+    ''' yield (sample, allele) one row at a time, e.g. (P123, 14|15)
+    '''
+    for line in locus_fp:
         if line.startswith("#"): continue
         l = line.split()
-        a_list.append((l[0][:-4], l[1].replace('/', '|'))) # P123.bam -> P123
+        yield (l[0][:-4], l[1].replace('/', '|')) # P123.bam -> P123
+
 
-    return a_list
+def abort_output(out_fp, output, message):
+    ''' remove the partly written matrix so it is not mistaken for a result
+    '''
+    out_fp.close()
+    os.remove(output)
+    sys.stderr.write("[Error] %s! (%s removed)\n" % (message, output))
+    sys.exit(-1)
 
 
 def process_main(file_path, output, order_list):
     ''' locus_list = [DYS19, DYS390, DYS392, ...]
-        allele_matrix = [[(P1, 14), (P2, 13), ...], [], [], ...]
+        the locus files are read in lockstep, so only one row per locus
+        is held in memory and each matrix row is written as soon as it
+        is complete
     '''
-    locus_list, allele_matrix = [], []
+    locus_list, fp_list, reader_list = [], [], []
     flist = order_list if order_list else os.listdir(file_path)
 
     for fn in flist:
         if fn == '.DS_Store': continue  # skip hidden file in macOS
         locus_file = os.path.join(file_path, fn)
-        locus_list.append(get_locus(locus_file))
-        allele_matrix.append(read_locus(locus_file))
+        locus_fp = open(locus_file, "r")
+        locus_list.append(get_locus(locus_fp, locus_file))
+        fp_list.append(locus_fp)
+        reader_list.append(read_locus(locus_fp))
 
     out_fp = open(output, "w")
     out_fp.write("Sample\t%s\n" % ('\t'.join(locus_list)))
 
-    for i in range(len(allele_matrix[0])):
-        for j in range(len(locus_list)):
-            if j == 0:
-                out_fp.write("%s\t%s\t" % (allele_matrix[j][i][0], allele_matrix[j][i][1]))
-            else: 
-                out_fp.write("%s\t" % allele_matrix[j][i][1])
-        out_fp.write("\n")
+    for row in itertools.zip_longest(*reader_list):
+        if None in row:
+            short = row.index(None)
+            other = 0 if short != 0 else next(j for j, r in enumerate(row) if r is not None)
+            abort_output(out_fp, output, "%s has fewer samples than %s"
+                         % (locus_list[short], locus_list[other]))
+
+        sample = row[0][0]
+        for j in range(1, len(row)):
+            if row[j][0] != sample:
+                abort_output(out_fp, output, "sample %s in %s does not match %s in %s"
+                             % (row[j][0], locus_list[j], sample, locus_list[0]))
+
+        out_fp.write("%s\t%s\t\n" % (sample, '\t'.join(a for _, a in row)))
 
     out_fp.close()
+    for locus_fp in fp_list:
+        locus_fp.close()
 
 
 if __name__ == "__main__":
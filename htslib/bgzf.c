@@ -974,7 +974,8 @@ int bgzf_read_block(BGZF *fp)
     return 0;
 }
 
-ssize_t bgzf_read(BGZF *fp, void *data, size_t length)
+// Shared by bgzf_read() and bgzf_skip(); a NULL data discards the bytes
+static ssize_t bgzf_read_core(BGZF *fp, void *data, size_t length)
 {
     ssize_t bytes_read = 0;
     uint8_t *output = (uint8_t*)data;
@@ -994,10 +995,12 @@ ssize_t bgzf_read(BGZF *fp, void *data, size_t length)
             if (available <= 0) break;
         }
         copy_length = length - bytes_read < available? length - bytes_read : available;
-        buffer = (uint8_t*)fp->uncompressed_block;
-        memcpy(output, buffer + fp->block_offset, copy_length);
+        if (output) {
+            buffer = (uint8_t*)fp->uncompressed_block;
+            memcpy(output, buffer + fp->block_offset, copy_length);
+            output += copy_length;
+        }
         fp->block_offset += copy_length;
-        output += copy_length;
         bytes_read += copy_length;
 
         // For raw gzip streams this avoids short reads.
@@ -1012,6 +1015,16 @@ ssize_t bgzf_read(BGZF *fp, void *data, size_t length)
     return bytes_read;
 }
 
+ssize_t bgzf_read(BGZF *fp, void *data, size_t length)
+{
+    return bgzf_read_core(fp, data, length);
+}
+
+ssize_t bgzf_skip(BGZF *fp, size_t length)
+{
+    return bgzf_read_core(fp, NULL, length);
+}
+
 ssize_t bgzf_raw_read(BGZF *fp, void *data, size_t length)
 {
     ssize_t ret = hread(fp->fp, data, length);
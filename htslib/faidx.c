@@ -34,6 +34,11 @@ DEALINGS IN THE SOFTWARE.  */
 #include <limits.h>
 #include <unistd.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "htslib/bgzf.h"
 #include "htslib/faidx.h"
@@ -52,6 +57,8 @@ KHASH_MAP_INIT_STR(s, faidx1_t)
 
 struct __faidx_t {
     BGZF *bgzf;
+    const char *map;  // whole uncompressed file when loaded with FAI_MMAP
+    size_t map_len;
     int n, m;
     char **name;
     khash_t(s) *hash;
@@ -425,6 +432,9 @@ void fai_destroy(faidx_t *fai)
     free(fai->name);
     kh_destroy(s, fai->hash);
     if (fai->bgzf) bgzf_close(fai->bgzf);
+#ifdef HAVE_MMAP
+    if (fai->map) munmap((void *) fai->map, fai->map_len);
+#endif
     free(fai);
 }
 
@@ -536,6 +546,34 @@ int fai_build(const char *fn) {
 }
 
 
+// Map an uncompressed FASTA/FASTQ read-only.  Returns 0 on success, or -1
+// if the file cannot be mapped, in which case the BGZF reader is kept.
+static int fai_map_file(faidx_t *fai, const char *fn)
+{
+#ifdef HAVE_MMAP
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (hisremote(fn)) return -1;
+    if ((fd = open(fn, O_RDONLY)) < 0) return -1;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0
+        || (uint64_t) st.st_size > SIZE_MAX) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    fai->map = (const char *) map;
+    fai->map_len = (size_t) st.st_size;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
 static faidx_t *fai_load3_core(const char *fn, const char *fnfai, const char *fngzi,
                    int flags, int format)
 {
@@ -648,7 +686,14 @@ static faidx_t *fai_load3_core(const char *fn, const char *fnfai, const char *fn
             hts_log_error("Failed to load .gzi index: %s", fngzi);
             goto fail;
         }
+    } else if (flags & FAI_MMAP) {
+        if (fai_map_file(fai, fn) == 0) {
+            bgzf_close(fai->bgzf);
+            fai->bgzf = NULL;
+        }
     }
+    if ((flags & FAI_MMAP) && !fai->map)
+        hts_log_warning("Could not map %s file %s, using buffered reads", file_type, fn);
     free(fai_kstr.s);
     free(gzi_kstr.s);
     return fai;
@@ -685,15 +730,53 @@ faidx_t *fai_load_format(const char *fn, enum fai_format_options format) {
 }
 
 
+// Line-aware copy straight out of the FAI_MMAP mapping
+static char *fai_retrieve_mapped(const faidx_t *fai, const faidx1_t *val,
+                                 uint64_t offset, long beg, long end, int *len) {
+    uint64_t pos = offset
+                   + beg / val->line_blen * val->line_len
+                   + beg % val->line_blen;
+    size_t l = 0, n = end > beg ? end - beg : 0, col = beg % val->line_blen;
+    char *s = (char*)malloc(n + 2);
+    if (!s) {
+        *len = -1;
+        return NULL;
+    }
+
+    while (l < n) {
+        size_t k = val->line_blen - col;
+        if (k > n - l) k = n - l;
+        if (pos >= fai->map_len || k > fai->map_len - pos) {
+            hts_log_error("Failed to retrieve block: unexpected end of file");
+            free(s);
+            *len = -1;
+            return NULL;
+        }
+        memcpy(s + l, fai->map + pos, k);
+        l += k;
+        pos += k + (val->line_len - val->line_blen);
+        col = 0;
+    }
+
+    s[l] = '\0';
+    *len = l < INT_MAX ? l : INT_MAX;
+    return s;
+}
+
 static char *fai_retrieve(const faidx_t *fai, const faidx1_t *val,
                           uint64_t offset, long beg, long end, int *len) {
     char *s;
     size_t l;
     int c = 0;
-    int ret = bgzf_useek(fai->bgzf,
-                         offset
-                         + beg / val->line_blen * val->line_len
-                         + beg % val->line_blen, SEEK_SET);
+    int ret;
+
+    if (fai->map)
+        return fai_retrieve_mapped(fai, val, offset, beg, end, len);
+
+    ret = bgzf_useek(fai->bgzf,
+                     offset
+                     + beg / val->line_blen * val->line_len
+                     + beg % val->line_blen, SEEK_SET);
 
     if (ret < 0) {
         *len = -1;
@@ -919,6 +1002,11 @@ char *faidx_fetch_qual(const faidx_t *fai, const char *c_name, int p_beg_i, int
 }
 
 
+int fai_is_mapped(const faidx_t *fai)
+{
+    return fai->map != NULL;
+}
+
 int faidx_has_seq(const faidx_t *fai, const char *seq)
 {
     khiter_t iter = kh_get(s, fai->hash, seq);
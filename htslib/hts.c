@@ -1033,6 +1033,14 @@ int hts_set_opt(htsFile *fp, enum hts_fmt_option opt, ...) {
         return 0;
     }
 
+    case CRAM_OPT_REQUIRED_FIELDS: {
+        // Also honoured when reading BAM; see bam_read1_fields()
+        va_start(args, opt);
+        fp->bam_required_fields = va_arg(args, int);
+        va_end(args);
+        break;
+    }
+
     case HTS_OPT_COMPRESSION_LEVEL: {
         va_start(args, opt);
         int level = va_arg(args, int);
@@ -138,6 +138,15 @@ typedef struct __kstring_t {
      */
     ssize_t bgzf_read(BGZF *fp, void *data, size_t length) HTS_RESULT_USED;
 
+    /**
+     * Advance past up to _length_ uncompressed bytes without copying them.
+     *
+     * @param fp     BGZF file handler
+     * @param length number of bytes to skip
+     * @return       number of bytes actually skipped; 0 on end-of-file and -1 on error
+     */
+    ssize_t bgzf_skip(BGZF *fp, size_t length) HTS_RESULT_USED;
+
     /**
      * Write _length_ bytes from _data_ to the file.  If no I/O errors occur,
      * the complete _length_ bytes will be written (or queued for writing).
@@ -101,6 +101,7 @@ void fai_destroy(faidx_t *fai);
 
 enum fai_load_options {
     FAI_CREATE = 0x01,
+    FAI_MMAP   = 0x02,
 };
 
 /// Load FASTA indexes.
@@ -116,6 +117,13 @@ The bgzip index is only needed if fn is compressed.
 
 If (flags & FAI_CREATE) is true, the index files will be built using
 fai_build3() if they are not already present.
+
+If (flags & FAI_MMAP) is true and fn is an uncompressed local file, it is
+memory-mapped read-only and fetches copy directly from the mapping instead
+of seeking and reading through a file handle, and the pages are shared with
+other processes mapping the same file.  Compressed, remote or unmappable
+files fall back to normal buffered reads with a warning; use
+fai_is_mapped() to find out which path was taken.
 */
 faidx_t *fai_load3(const char *fn, const char *fnfai, const char *fngzi,
                    int flags);
@@ -209,6 +217,16 @@ by end users by calling `free()` on it.
 */
 char *faidx_fetch_qual(const faidx_t *fai, const char *c_name, int p_beg_i, int p_end_i, int *len);
 
+/// Query if the sequence data is memory-mapped
+/**   @param  fai  Pointer to the faidx_t struct
+      @return      1 if loaded with FAI_MMAP and the mapping is in effect,
+                   0 if fetches go through a buffered file handle
+
+Only a mapped faidx_t may be fetched from by several threads at once; the
+buffered path seeks a single shared handle and needs one faidx_t per thread.
+*/
+int fai_is_mapped(const faidx_t *fai);
+
 /// Query if sequence is present
 /**   @param  fai  Pointer to the faidx_t struct
       @param  seq  Sequence name
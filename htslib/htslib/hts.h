@@ -175,6 +175,7 @@ typedef struct {
         struct hFILE *hfile;
     } fp;
     htsFormat format;
+    int bam_required_fields;  // SAM_* mask for BAM reads; 0 decodes everything
 } htsFile;
 
 // A combined thread pool and queue allocation size.
@@ -227,7 +228,7 @@ enum hts_fmt_option {
     CRAM_OPT_THREAD_POOL,// make general
     CRAM_OPT_USE_LZMA,
     CRAM_OPT_USE_RANS,
-    CRAM_OPT_REQUIRED_FIELDS,
+    CRAM_OPT_REQUIRED_FIELDS,  // also applies to BAM input
     CRAM_OPT_LOSSY_NAMES,
     CRAM_OPT_BASES_PER_SLICE,
     CRAM_OPT_STORE_MD,
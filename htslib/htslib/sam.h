@@ -280,6 +280,24 @@ typedef struct {
     bam1_t *bam_init1(void);
     void bam_destroy1(bam1_t *b);
     int bam_read1(BGZF *fp, bam1_t *b) HTS_RESULT_USED;
+
+    /*!
+      @abstract  Read a BAM record, decoding only the requested fields
+      @param  fp      BGZF handle positioned at a record
+      @param  b       record to fill in
+      @param  fields  mask of enum sam_fields values, or 0 for everything
+      @return         as bam_read1()
+
+      @discussion Core fields, CIGAR and SEQ are always decoded.  Without
+      SAM_QNAME the read name becomes "*"; without SAM_QUAL the qualities
+      are set to 0xff (missing); without SAM_AUX or SAM_RGAUX the aux data
+      is left out, except for records whose CIGAR must be restored from a
+      CG tag.  Skipped bytes are passed over in the BGZF block instead of
+      being copied into b.  sam_read1() and the sam_itr_*() iterators use
+      this with the mask set by hts_set_opt(fp, CRAM_OPT_REQUIRED_FIELDS, ...),
+      so BAM and CRAM inputs can be trimmed the same way.
+    */
+    int bam_read1_fields(BGZF *fp, bam1_t *b, int fields) HTS_RESULT_USED;
     int bam_write1(BGZF *fp, const bam1_t *b) HTS_RESULT_USED;
     bam1_t *bam_copy1(bam1_t *bdst, const bam1_t *bsrc);
     bam1_t *bam_dup1(const bam1_t *bsrc);
@@ -300,6 +318,22 @@ typedef struct {
     */
     int32_t bam_endpos(const bam1_t *b);
 
+    /*!
+      @abstract  Decode part of the query sequence to IUPAC characters
+      @param  b    pointer to an alignment
+      @param  beg  0-based offset of the first base on the query
+      @param  len  number of bases to decode
+      @param  seq  buffer of at least len+1 bytes for the NUL-terminated result
+      @return      number of bases written (len), or -1 if [beg, beg+len)
+                   is not within the query sequence
+
+      @discussion Produces the same characters as seq_nt16_str[bam_seqi()]
+      applied base by base, but decodes two bases per packed byte and, on
+      x86-64 CPUs with SSSE3, 32 bases per vector step.  Passing beg=0 and
+      len=b->core.l_qseq decodes the whole read.
+    */
+    int bam_seq_decode(const bam1_t *b, int beg, int len, char *seq);
+
     int   bam_str2flag(const char *str);    /** returns negative value on error */
     char *bam_flag2str(int flag);   /** The string must be freed by the user */
 
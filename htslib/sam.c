@@ -396,6 +396,79 @@ int32_t bam_endpos(const bam1_t *b)
         return b->core.pos + 1;
 }
 
+/* Pairs of IUPAC characters for every possible packed sequence byte */
+static const char code2base[512] =
+    "===A=C=M=G=R=S=V=T=W=Y=H=K=D=B=N"
+    "A=AAACAMAGARASAVATAWAYAHAKADABAN"
+    "C=CACCCMCGCRCSCVCTCWCYCHCKCDCBCN"
+    "M=MAMCMMMGMRMSMVMTMWMYMHMKMDMBMN"
+    "G=GAGCGMGGGRGSGVGTGWGYGHGKGDGBGN"
+    "R=RARCRMRGRRRSRVRTRWRYRHRKRDRBRN"
+    "S=SASCSMSGSRSSSVSTSWSYSHSKSDSBSN"
+    "V=VAVCVMVGVRVSVVVTVWVYVHVKVDVBVN"
+    "T=TATCTMTGTRTSTVTTTWTYTHTKTDTBTN"
+    "W=WAWCWMWGWRWSWVWTWWWYWHWKWDWBWN"
+    "Y=YAYCYMYGYRYSYVYTYWYYYHYKYDYBYN"
+    "H=HAHCHMHGHRHSHVHTHWHYHHHKHDHBHN"
+    "K=KAKCKMKGKRKSKVKTKWKYKHKKKDKBKN"
+    "D=DADCDMDGDRDSDVDTDWDYDHDKDDDBDN"
+    "B=BABCBMBGBRBSBVBTBWBYBHBKBDBBBN"
+    "N=NANCNMNGNRNSNVNTNWNYNHNKNDNBNN";
+
+// Decode len bases starting at the high nibble of nib[0]
+static inline void nibble2base(const uint8_t *nib, char *seq, int len)
+{
+    int i;
+    for (i = 0; i + 2 <= len; i += 2)
+        memcpy(seq + i, code2base + (size_t)nib[i>>1] * 2, 2);
+    if (i < len) seq[i] = seq_nt16_str[nib[i>>1] >> 4];
+}
+
+#if defined(__x86_64__) && (defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HTS_NIBBLE2BASE_SSSE3 1
+#include <tmmintrin.h>
+
+// 16 packed bytes (32 bases) per iteration via a PSHUFB table lookup
+__attribute__((target("ssse3")))
+static void nibble2base_ssse3(const uint8_t *nib, char *seq, int len)
+{
+    const __m128i lut = _mm_setr_epi8('=', 'A', 'C', 'M', 'G', 'R', 'S', 'V',
+                                      'T', 'W', 'Y', 'H', 'K', 'D', 'B', 'N');
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i;
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m128i v  = _mm_loadu_si128((const __m128i *)(nib + (i>>1)));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)(seq + i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(seq + i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    nibble2base(nib + (i>>1), seq + i, len - i);
+}
+#endif
+
+int bam_seq_decode(const bam1_t *b, int beg, int len, char *seq)
+{
+    const uint8_t *nib = bam_get_seq(b);
+    int n = len;
+
+    if (beg < 0 || len < 0 || beg > b->core.l_qseq - len) return -1;
+    if ((beg & 1) && len > 0) { // odd start: emit the low nibble on its own
+        *seq++ = seq_nt16_str[bam_seqi(nib, beg)];
+        ++beg, --len;
+    }
+    nib += beg >> 1;
+#ifdef HTS_NIBBLE2BASE_SSSE3
+    if (len >= 32 && __builtin_cpu_supports("ssse3"))
+        nibble2base_ssse3(nib, seq, len);
+    else
+#endif
+        nibble2base(nib, seq, len);
+    seq[len] = '\0';
+    return n;
+}
+
 static int bam_tag2cigar(bam1_t *b, int recal_bin, int give_warning) // return 0 if CIGAR is untouched; 1 if CIGAR is updated with CG
 {
     bam1_core_t *c = &b->core;
@@ -458,10 +531,16 @@ static void swap_data(const bam1_core_t *c, int l_data, uint8_t *data, int is_ho
 }
 
 int bam_read1(BGZF *fp, bam1_t *b)
+{
+    return bam_read1_fields(fp, b, 0);
+}
+
+int bam_read1_fields(BGZF *fp, bam1_t *b, int fields)
 {
     bam1_core_t *c = &b->core;
     int32_t block_len, ret, i;
-    uint32_t x[8], new_l_data;
+    uint32_t x[8], new_l_data, l_qname, l_cigseq, l_aux, l_tail;
+    int keep_qname = 1, keep_qual = 1, keep_aux = 1, aux_done;
     if ((ret = bgzf_read(fp, &block_len, 4)) != 4) {
         if (ret == 0) return -1; // normal end-of-file
         else return -2; // truncated
@@ -487,16 +566,62 @@ int bam_read1(BGZF *fp, bam1_t *b)
     if (((uint64_t) c->n_cigar << 2) + c->l_qname + c->l_extranul
         + (((uint64_t) c->l_qseq + 1) >> 1) + c->l_qseq > (uint64_t) new_l_data)
         return -4;
+
+    // Sizes of the on-disk record sections; qname has no padding on disk
+    l_qname = c->l_qname;
+    l_cigseq = (c->n_cigar << 2) + ((c->l_qseq + 1) >> 1);
+    l_aux = block_len - 32 - l_qname - l_cigseq - c->l_qseq;
+
+    if (fields) {
+        keep_qname = (fields & SAM_QNAME) != 0;
+        keep_qual = (fields & SAM_QUAL) != 0;
+        keep_aux = (fields & (SAM_AUX | SAM_RGAUX)) != 0;
+    }
+    if (!keep_qname) { // stored as "*", padded to 4 bytes
+        c->l_qname = 2;
+        c->l_extranul = 2;
+    }
+    new_l_data = c->l_qname + c->l_extranul + l_cigseq + c->l_qseq
+        + (keep_aux ? l_aux : 0);
     if (realloc_bam_data(b, new_l_data) < 0) return -4;
     b->l_data = new_l_data;
 
-    if (bgzf_read(fp, b->data, c->l_qname) != c->l_qname) return -4;
+    if (keep_qname) {
+        if (bgzf_read(fp, b->data, c->l_qname) != c->l_qname) return -4;
+    } else {
+        if (bgzf_skip(fp, l_qname) != l_qname) return -4;
+        b->data[0] = '*';
+        b->data[1] = '\0';
+    }
     for (i = 0; i < c->l_extranul; ++i) b->data[c->l_qname+i] = '\0';
     c->l_qname += c->l_extranul;
-    if (b->l_data < c->l_qname ||
-        bgzf_read(fp, b->data + c->l_qname, b->l_data - c->l_qname) != b->l_data - c->l_qname)
-        return -4;
+    // Everything after qname is read in one go unless some of it is dropped
+    aux_done = keep_qual && keep_aux;
+    l_tail = l_cigseq + (keep_qual ? c->l_qseq : 0) + (aux_done ? l_aux : 0);
+    if (bgzf_read(fp, b->data + c->l_qname, l_tail) != l_tail) return -4;
     if (fp->is_be) swap_data(c, b->l_data, b->data, 0);
+
+    if (!keep_qual) {
+        if (bgzf_skip(fp, c->l_qseq) != c->l_qseq) return -4;
+        if (c->l_qseq) memset(bam_get_qual(b), 0xff, c->l_qseq);
+    }
+    if (!keep_aux && c->n_cigar > 0) {
+        // A CIGAR of just <l_qseq>S may be a placeholder for a long CIGAR
+        // kept in the CG tag, so the aux data is still needed to restore it
+        uint32_t cigar0 = bam_get_cigar(b)[0];
+        if (bam_cigar_op(cigar0) == BAM_CSOFT_CLIP && bam_cigar_oplen(cigar0) == c->l_qseq) {
+            if (possibly_expand_bam_data(b, l_aux) < 0) return -4;
+            b->l_data += l_aux;
+            keep_aux = 1;
+        }
+    }
+    if (!aux_done) {
+        if (keep_aux) {
+            if (bgzf_read(fp, bam_get_aux(b), l_aux) != l_aux) return -4;
+        } else {
+            if (bgzf_skip(fp, l_aux) != l_aux) return -4;
+        }
+    }
     if (bam_tag2cigar(b, 0, 0) < 0)
         return -4;
 
@@ -654,11 +779,13 @@ int bam_index_build(const char *fn, int min_shift)
     return sam_index_build2(fn, NULL, min_shift);
 }
 
-static int bam_readrec(BGZF *fp, void *ignored, void *bv, int *tid, int *beg, int *end)
+// data is the owning htsFile for sam_itr_next(), or NULL for bam_itr_next()
+static int bam_readrec(BGZF *fp, void *data, void *bv, int *tid, int *beg, int *end)
 {
+    htsFile *hfp = data;
     bam1_t *b = bv;
     int ret;
-    if ((ret = bam_read1(fp, b)) >= 0) {
+    if ((ret = bam_read1_fields(fp, b, hfp ? hfp->bam_required_fields : 0)) >= 0) {
         *tid = b->core.tid;
         *beg = b->core.pos;
         *end = bam_endpos(b);
@@ -751,7 +878,7 @@ static int sam_bam_cram_readrec(BGZF *bgzfp, void *fpv, void *bv, int *tid, int
     htsFile *fp = fpv;
     bam1_t *b = bv;
     switch (fp->format.format) {
-    case bam:   return bam_read1(bgzfp, b);
+    case bam:   return bam_read1_fields(bgzfp, b, fp->bam_required_fields);
     case cram: {
         int ret = cram_get_bam_seq(fp->fp.cram, &b);
         if (ret < 0)
@@ -1435,7 +1562,7 @@ int sam_read1(htsFile *fp, bam_hdr_t *h, bam1_t *b)
 {
     switch (fp->format.format) {
     case bam: {
-        int r = bam_read1(fp->fp.bgzf, b);
+        int r = bam_read1_fields(fp->fp.bgzf, b, fp->bam_required_fields);
         if (r >= 0) {
             if (b->core.tid  >= h->n_targets || b->core.tid  < -1 ||
                 b->core.mtid >= h->n_targets || b->core.mtid < -1)
@@ -1507,8 +1634,9 @@ int sam_format1(const bam_hdr_t *h, const bam1_t *b, kstring_t *str)
     kputw(c->mpos + 1, str); kputc('\t', str); // mate pos
     kputw(c->isize, str); kputc('\t', str); // template len
     if (c->l_qseq) { // seq and qual
-        uint8_t *s = bam_get_seq(b);
-        for (i = 0; i < c->l_qseq; ++i) kputc("=ACMGRSVTWYHKDBN"[bam_seqi(s, i)], str);
+        uint8_t *s;
+        if (ks_resize(str, str->l + c->l_qseq + 1) < 0) return -1;
+        str->l += bam_seq_decode(b, 0, c->l_qseq, str->s + str->l);
         kputc('\t', str);
         s = bam_get_qual(b);
         if (s[0] == 0xff) kputc('*', str);
@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.  */
 #include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <math.h>
 
 // Suppress message for faidx_fetch_nseq(), which we're intentionally testing
@@ -40,6 +41,8 @@ DEALINGS IN THE SOFTWARE.  */
 #include "htslib/sam.h"
 #include "htslib/faidx.h"
 #include "htslib/kstring.h"
+#include "htslib/bgzf.h"
+#include "htslib/hts_log.h"
 
 int status;
 
@@ -447,6 +450,44 @@ static int aux_fields1(void)
     return 1;
 }
 
+static void seq_decode1(void)
+{
+    static const char hdr_text[] = "@SQ\tSN:CHROMOSOME_I\tLN:5000\n";
+    static const char seq[] =
+        "ACGTNACMGRSVTWYHKDBN=ACGTACGTTTGCAAGCTTAGCATGGATCCAAGGTTCCAGGATC"
+        "NNNNACGTAGCTAGGCATGCAGTCAGGCAT";
+    char line[512], out[sizeof seq];
+    kstring_t ks = { 0, 0, NULL };
+    bam_hdr_t *h = sam_hdr_parse(sizeof hdr_text - 1, hdr_text);
+    bam1_t *b = bam_init1();
+    int len = sizeof seq - 1, beg, n;
+
+    if (h == NULL || b == NULL) { fail("can't set up seq_decode1"); goto end; }
+    snprintf(line, sizeof line, "r\t0\tCHROMOSOME_I\t100\t10\t%dM\t*\t0\t0\t%s\t*",
+             len, seq);
+    kputs(line, &ks);
+    if (sam_parse1(&ks, h, b) < 0) { fail("can't parse seq_decode1 record"); goto end; }
+
+    for (beg = 0; beg <= len; beg++)
+        for (n = 0; beg + n <= len; n++) {
+            memset(out, 'x', sizeof out);
+            if (bam_seq_decode(b, beg, n, out) != n)
+                fail("bam_seq_decode(%d, %d) failed", beg, n);
+            else if (memcmp(out, seq + beg, n) != 0 || out[n] != '\0')
+                fail("bam_seq_decode(%d, %d) gave \"%.*s\"", beg, n, n, out);
+        }
+
+    if (bam_seq_decode(b, 1, len, out) != -1)
+        fail("bam_seq_decode accepted a slice past the end of the read");
+    if (bam_seq_decode(b, -1, 1, out) != -1)
+        fail("bam_seq_decode accepted a negative offset");
+
+ end:
+    free(ks.s);
+    bam_destroy1(b);
+    bam_hdr_destroy(h);
+}
+
 static void iterators1(void)
 {
     hts_itr_destroy(sam_itr_queryi(NULL, HTS_IDX_REST, 0, 0));
@@ -541,12 +582,244 @@ static void samrecord_layout(void)
                          "test/sam_alignment.tmp.sam_", "w", NULL);
 }
 
+// Write ce#1000.sam plus one record with a >65535-op CIGAR (stored in CG)
+static int write_required_fields_bam(const char *bam)
+{
+    enum { n_ops = 70000 };
+    samFile *in = sam_open("test/ce#1000.sam", "r");
+    samFile *out = sam_open(bam, "wb");
+    bam_hdr_t *h = NULL;
+    bam1_t *aln = bam_init1();
+    kstring_t ks = { 0, 0, NULL };
+    int i, res, ret = -1;
+
+    if (!in || !out || !aln) { fail("can't set up %s", bam); goto end; }
+    if ((h = sam_hdr_read(in)) == NULL) { fail("reading ce#1000.sam header"); goto end; }
+    if (sam_hdr_write(out, h) < 0) { fail("writing header to %s", bam); goto end; }
+    while ((res = sam_read1(in, h, aln)) >= 0)
+        if (sam_write1(out, h, aln) < 0) { fail("writing to %s", bam); goto end; }
+    if (res < -1) { fail("failed to read alignment from ce#1000.sam"); goto end; }
+
+    kputs("long_cigar\t0\tCHROMOSOME_I\t200\t30\t", &ks);
+    for (i = 0; i < n_ops / 2; i++) kputs("1M1I", &ks);
+    kputs("\t*\t0\t0\t", &ks);
+    for (i = 0; i < n_ops; i++) kputc("ACGT"[i & 3], &ks);
+    kputc('\t', &ks);
+    for (i = 0; i < n_ops; i++) kputc('I', &ks);
+    kputs("\tXA:Z:aux", &ks);
+    if (sam_parse1(&ks, h, aln) < 0) { fail("can't parse long CIGAR record"); goto end; }
+    if (sam_write1(out, h, aln) < 0) { fail("writing long CIGAR record"); goto end; }
+    ret = 0;
+
+ end:
+    free(ks.s);
+    bam_destroy1(aln);
+    bam_hdr_destroy(h);
+    if (in) sam_close(in);
+    if (out && sam_close(out) < 0) { fail("closing %s", bam); ret = -1; }
+    if (ret == 0 && sam_index_build(bam, 0) < 0) { fail("indexing %s", bam); ret = -1; }
+    return ret;
+}
+
+// Check record b, read with the given mask, against the full record a
+static void check_required_fields(const bam1_t *a, const bam1_t *b, int fields,
+                                  const char *how, int n)
+{
+    const bam1_core_t *c = &a->core;
+    int keep_aux = (fields & SAM_AUX) || c->n_cigar > 0xffff;
+    int i;
+
+    if (c->tid != b->core.tid || c->pos != b->core.pos
+        || c->bin != b->core.bin || c->qual != b->core.qual
+        || c->flag != b->core.flag || c->n_cigar != b->core.n_cigar
+        || c->l_qseq != b->core.l_qseq || c->mtid != b->core.mtid
+        || c->mpos != b->core.mpos || c->isize != b->core.isize) {
+        fail("%s, fields %#x, record %d: core fields differ", how, fields, n);
+        return;
+    }
+    if (memcmp(bam_get_cigar(a), bam_get_cigar(b), c->n_cigar * 4) != 0
+        || memcmp(bam_get_seq(a), bam_get_seq(b), (c->l_qseq + 1) / 2) != 0)
+        fail("%s, fields %#x, record %d: CIGAR or SEQ differ", how, fields, n);
+
+    if (fields & SAM_QNAME) {
+        if (strcmp(bam_get_qname(a), bam_get_qname(b)) != 0)
+            fail("%s, fields %#x, record %d: QNAME differs", how, fields, n);
+    } else if (strcmp(bam_get_qname(b), "*") != 0) {
+        fail("%s, fields %#x, record %d: QNAME not dropped", how, fields, n);
+    }
+
+    if (fields & SAM_QUAL) {
+        if (memcmp(bam_get_qual(a), bam_get_qual(b), c->l_qseq) != 0)
+            fail("%s, fields %#x, record %d: QUAL differs", how, fields, n);
+    } else {
+        for (i = 0; i < c->l_qseq; i++)
+            if (bam_get_qual(b)[i] != 0xff) break;
+        if (i < c->l_qseq)
+            fail("%s, fields %#x, record %d: QUAL not dropped", how, fields, n);
+    }
+
+    if (keep_aux) {
+        if (bam_get_l_aux(a) != bam_get_l_aux(b)
+            || memcmp(bam_get_aux(a), bam_get_aux(b), bam_get_l_aux(a)) != 0)
+            fail("%s, fields %#x, record %d: aux differs", how, fields, n);
+    } else if (bam_get_l_aux(b) != 0) {
+        fail("%s, fields %#x, record %d: aux not dropped", how, fields, n);
+    }
+}
+
+enum { RF_READ, RF_QUERY, RF_REST, RF_MULTI };
+
+// Read bam in full and with fields in lockstep, via the given access method
+static void required_fields_pass(const char *bam, int fields, int how)
+{
+    static const char *how_name[] = {
+        "sam_read1", "indexed iterator", "HTS_IDX_REST iterator", "multi-region iterator"
+    };
+    samFile *fp[2] = { NULL, NULL };
+    bam_hdr_t *h[2] = { NULL, NULL };
+    hts_idx_t *idx[2] = { NULL, NULL };
+    hts_itr_t *itr[2] = { NULL, NULL };
+    hts_itr_multi_t *mitr[2] = { NULL, NULL };
+    bam1_t *b[2] = { bam_init1(), bam_init1() };
+    int i, r[2], n = 0, n_long = 0;
+
+    for (i = 0; i < 2; i++) {
+        if ((fp[i] = sam_open(bam, "r")) == NULL || !b[i]) {
+            fail("can't open %s", bam);
+            goto end;
+        }
+        if (i == 1 && hts_set_opt(fp[i], CRAM_OPT_REQUIRED_FIELDS, fields) < 0)
+            fail("setting CRAM_OPT_REQUIRED_FIELDS on BAM");
+        if ((h[i] = sam_hdr_read(fp[i])) == NULL) {
+            fail("reading header from %s", bam);
+            goto end;
+        }
+        if (how == RF_QUERY || how == RF_MULTI) {
+            if ((idx[i] = sam_index_load(fp[i], bam)) == NULL) {
+                fail("loading index of %s", bam);
+                goto end;
+            }
+        }
+        if (how == RF_QUERY) {
+            itr[i] = sam_itr_querys(idx[i], h[i], "CHROMOSOME_I");
+        } else if (how == RF_REST) {
+            itr[i] = sam_itr_queryi(NULL, HTS_IDX_REST, 0, 0);
+        } else if (how == RF_MULTI) {
+            hts_reglist_t *reg = calloc(1, sizeof(hts_reglist_t));
+            if (reg && (reg->intervals = calloc(2, sizeof(hts_pair32_t)))) {
+                reg->reg = "CHROMOSOME_I";
+                reg->tid = 0;
+                reg->count = 2;
+                reg->intervals[0].beg = 0;   reg->intervals[0].end = 60;
+                reg->intervals[1].beg = 150; reg->intervals[1].end = 300;
+                reg->min_beg = 0;
+                reg->max_end = 300;
+                mitr[i] = sam_itr_regions(idx[i], h[i], reg, 1);
+            } else {
+                free(reg);
+            }
+        }
+        if ((how == RF_QUERY || how == RF_REST) && !itr[i]) {
+            fail("creating %s", how_name[how]);
+            goto end;
+        }
+        if (how == RF_MULTI && !mitr[i]) {
+            fail("creating %s", how_name[how]);
+            goto end;
+        }
+    }
+
+    for (;;) {
+        for (i = 0; i < 2; i++) {
+            if (how == RF_READ) r[i] = sam_read1(fp[i], h[i], b[i]);
+            else if (how == RF_MULTI) r[i] = sam_itr_multi_next(fp[i], mitr[i], b[i]);
+            else r[i] = sam_itr_next(fp[i], itr[i], b[i]);
+        }
+        if (r[0] < 0 || r[1] < 0) break;
+        check_required_fields(b[0], b[1], fields, how_name[how], n);
+        if (b[0]->core.n_cigar > 0xffff) n_long++;
+        n++;
+    }
+    if (r[0] != r[1] || r[0] < -1)
+        fail("%s, fields %#x: reads ended with %d (full) and %d (masked) after %d records",
+             how_name[how], fields, r[0], r[1], n);
+    if (n == 0 || n_long != 1)
+        fail("%s, fields %#x: read %d records, %d with a long CIGAR",
+             how_name[how], fields, n, n_long);
+
+ end:
+    for (i = 0; i < 2; i++) {
+        hts_itr_destroy(itr[i]);
+        hts_itr_multi_destroy(mitr[i]);
+        if (idx[i]) hts_idx_destroy(idx[i]);
+        bam_hdr_destroy(h[i]);
+        bam_destroy1(b[i]);
+        if (fp[i]) sam_close(fp[i]);
+    }
+}
+
+static void required_fields1(void)
+{
+    const char *bam = "test/sam_required_fields.tmp.bam";
+    const int core = SAM_FLAG | SAM_RNAME | SAM_POS | SAM_MAPQ | SAM_CIGAR | SAM_SEQ;
+    const int masks[] = {
+        core, core | SAM_QNAME, core | SAM_QUAL, core | SAM_AUX,
+        core | SAM_QNAME | SAM_QUAL | SAM_AUX
+    };
+    int i, how;
+
+    if (write_required_fields_bam(bam) < 0) return;
+    for (i = 0; i < sizeof masks / sizeof masks[0]; i++)
+        for (how = RF_READ; how <= RF_MULTI; how++)
+            required_fields_pass(bam, masks[i], how);
+}
+
+// FAI_MMAP on a bgzipped copy must fall back to buffered reads and say so
+static void faidx_mmap_bgzf(const char *filename, const char *plainname,
+                            const faidx_t *fai)
+{
+    char gzfilename[FILENAME_MAX], buf[4096];
+    const char *name = faidx_iseq(fai, 0);
+    FILE *fin = fopen(plainname, "rb");
+    BGZF *out;
+    faidx_t *fai_gz;
+    size_t n;
+    int l1, l2, level = hts_get_log_level();
+    char *s1, *s2;
+
+    sprintf(gzfilename, "%s.gz", plainname);
+    if (fin == NULL) { fail("can't open %s", plainname); return; }
+    out = bgzf_open(gzfilename, "w");
+    if (out == NULL) { fail("can't create %s", gzfilename); fclose(fin); return; }
+    while ((n = fread(buf, 1, sizeof buf, fin)) > 0)
+        if (bgzf_write(out, buf, n) < 0) fail("can't write %s", gzfilename);
+    fclose(fin);
+    if (bgzf_close(out) < 0) { fail("can't close %s", gzfilename); return; }
+
+    if (fai_build(gzfilename) < 0) { fail("can't index %s", gzfilename); return; }
+    hts_set_log_level(HTS_LOG_ERROR);  // the fallback warning is expected
+    fai_gz = fai_load3(gzfilename, NULL, NULL, FAI_MMAP);
+    hts_set_log_level(level);
+    if (fai_gz == NULL) { fail("can't load %s with FAI_MMAP", gzfilename); return; }
+
+    if (fai_is_mapped(fai_gz))
+        fail("%s: FAI_MMAP on a bgzipped file reported as mapped", gzfilename);
+
+    s1 = faidx_fetch_seq(fai, name, 0, 199, &l1);
+    s2 = faidx_fetch_seq(fai_gz, name, 0, 199, &l2);
+    if (s1 == NULL || s2 == NULL || l1 != l2 || strcmp(s1, s2) != 0)
+        fail("%s: fetch of %s through the buffered fallback differs", gzfilename, name);
+    free(s1);
+    free(s2);
+    fai_destroy(fai_gz);
+}
+
 static void faidx1(const char *filename)
 {
-    int n, n_exp = 0, n_fq_exp = 0;
+    int i, n, n_exp = 0, n_fq_exp = 0;
     char tmpfilename[FILENAME_MAX], line[500];
     FILE *fin, *fout;
-    faidx_t *fai;
+    faidx_t *fai, *fai_mmap;
 
     fin = fopen(filename, "rb");
     if (fin == NULL) fail("can't open %s\n", filename);
@@ -578,6 +851,35 @@ static void faidx1(const char *filename)
     if (n != n_exp)
         fail("%s: faidx_nseq returned %d, expected %d", filename, n, n_exp);
 
+    if (fai_is_mapped(fai))
+        fail("%s: loaded without FAI_MMAP but reported as mapped", filename);
+
+    fai_mmap = fai_load3(tmpfilename, NULL, NULL, FAI_MMAP);
+    if (fai_mmap == NULL) fail("can't load faidx file %s with FAI_MMAP", tmpfilename);
+    else {
+#ifdef HAVE_MMAP
+        if (!fai_is_mapped(fai_mmap))
+            fail("%s: FAI_MMAP load of a plain file is not mapped", filename);
+#endif
+        for (i = 0; i < n; i++) {
+            const char *name = faidx_iseq(fai, i);
+            static const int span[] = { 0, 1, 49, 50, 51, 137, INT_MAX - 1 };
+            int seq_len = faidx_seq_len(fai, name), beg, k;
+            for (beg = 0; beg < seq_len; beg += 1 + seq_len / 61)
+                for (k = 0; k < sizeof span / sizeof span[0]; k++) {
+                    int l1, l2, end = span[k] < seq_len - beg ? beg + span[k] : seq_len - 1;
+                    char *s1 = faidx_fetch_seq(fai, name, beg, end, &l1);
+                    char *s2 = faidx_fetch_seq(fai_mmap, name, beg, end, &l2);
+                    if (s1 == NULL || s2 == NULL || l1 != l2 || strcmp(s1, s2) != 0)
+                        fail("%s: FAI_MMAP fetch of %s:%d-%d differs", filename, name, beg, end);
+                    free(s1);
+                    free(s2);
+                }
+        }
+        fai_destroy(fai_mmap);
+    }
+
+    faidx_mmap_bgzf(filename, tmpfilename, fai);
     fai_destroy(fai);
 }
 
@@ -597,7 +899,9 @@ int main(int argc, char **argv)
 
     aux_fields1();
     iterators1();
+    seq_decode1();
     samrecord_layout();
+    required_fields1();
     check_enum1();
     for (i = 1; i < argc; i++) faidx1(argv[i]);
 